@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -7,8 +8,13 @@
 #include <sys/msg.h>
 #include <string.h>
 #include <errno.h>
+#include "placement.h"
 
 #define MAX_GROUPS 30
+#define MAX_MESSAGES 1000
+#define ROUND_TRIP_MTYPE 1000
+#define ROUND_TRIP_CHUNK 64
+#define ROUND_TRIP_ACK_MTYPE 2000
 
 typedef struct
 {
@@ -17,11 +23,70 @@ typedef struct
     char status[100];
 }msg_buffer;
 
+// moderator round trip samples from a group, only sent with --stats.
+// The chunk marked last is acked with ROUND_TRIP_ACK_MTYPE + group_id so the
+// group only terminates once its samples are safely out of the queue
+typedef struct
+{
+    long mtype;
+    int group_id;
+    int count;
+    int last;
+    long samples[ROUND_TRIP_CHUNK];
+} round_trip_buffer;
+
+// both kinds of message share the app queue
+typedef union
+{
+    msg_buffer status;
+    round_trip_buffer round_trip;
+} app_message;
+
+long round_trips[MAX_GROUPS * MAX_MESSAGES];
+int round_trip_count = 0;
+int round_trip_groups = 0;
+
+int compare_longs(const void *a, const void *b)
+{
+    long x = *(const long *)a;
+    long y = *(const long *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of sorted samples
+long percentile(const long sorted[], int count, int pct)
+{
+    int rank = (count * pct + 99) / 100;
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+// pooled over every group so runs with and without --placement can be compared
+void ReportRoundTrips(int num_groups)
+{
+    if (round_trip_groups < num_groups)
+    {
+        printf("Warning: round trips from only %d of %d groups, percentiles below are partial\n",
+               round_trip_groups, num_groups);
+    }
+    if (round_trip_count == 0)
+    {
+        return;
+    }
+    qsort(round_trips, round_trip_count, sizeof(long), compare_longs);
+    printf("Moderator round trip over %d messages: p50 %ld us, p99 %ld us, max %ld us\n",
+           round_trip_count, percentile(round_trips, round_trip_count, 50),
+           percentile(round_trips, round_trip_count, 99), round_trips[round_trip_count - 1]);
+}
+
 // this creates multiple groups and creates separate processes for each group
-void GroupFormation(int num_groups, char groupFiles[][256], int app_key, int mod_key, int val_key, int threshold, int msgid, int testcase)
+// with a placement plan each group (and the users it forks) is pinned before exec
+void GroupFormation(int num_groups, char groupFiles[][256], int app_key, int mod_key, int val_key, int threshold, int msgid, int testcase, const Placement *plan, int stats)
 {
     pid_t pids[num_groups];
 
+    // buffered output would otherwise be flushed again by every child
+    fflush(stdout);
+
     for (int i = 0; i < num_groups; i++)
     {
         char *underscore = strrchr(groupFiles[i], '_');
@@ -29,6 +94,14 @@ void GroupFormation(int num_groups, char groupFiles[][256], int app_key, int mod
         pids[i] = fork();
         if (pids[i] == 0)
         {
+            if (plan)
+            {
+                char who[32];
+                snprintf(who, sizeof(who), "Group %d", group_id);
+                PinToCpu(0, GroupCpu(plan, i), who);
+                fflush(stdout);
+            }
+
             char group_id_str[10];
             snprintf(group_id_str, sizeof(group_id_str), "%d", group_id);
 
@@ -39,19 +112,21 @@ void GroupFormation(int num_groups, char groupFiles[][256], int app_key, int mod
             snprintf(threshold_str, sizeof(threshold_str), "%d", threshold);
             snprintf(testcase_str, sizeof(testcase_str), "%d", testcase);
 
-            execl("./groups.out", "groups.out", groupFiles[i], group_id_str, app_key_str, mod_key_str, val_key_str, threshold_str, testcase_str, NULL);
+            execl("./groups.out", "groups.out", groupFiles[i], group_id_str, app_key_str, mod_key_str, val_key_str, threshold_str, testcase_str, stats ? "--stats" : NULL, NULL);
             perror("Error executing group process");
             exit(EXIT_FAILURE);
         }
     }
 
     int active_groups = num_groups;
-    msg_buffer message;
+    app_message message;
     while (active_groups > 0)
     {
-        if (msgrcv(msgid, &message, sizeof(message) - sizeof(long), 0, 0) == -1)
+        // acks sent back to the groups have larger types and are skipped here
+        if (msgrcv(msgid, &message, sizeof(message) - sizeof(long), -ROUND_TRIP_MTYPE, 0) == -1)
         {
-            if (errno == EIDRM)
+            // validation.out removes the queue once every group has terminated
+            if (errno == EIDRM || errno == EINVAL)
             {
                 break;
             }
@@ -61,16 +136,53 @@ void GroupFormation(int num_groups, char groupFiles[][256], int app_key, int mod
                 exit(EXIT_FAILURE);
             }
         }
-        printf("All users terminated. Exiting group process %d. Status: inactive\n", message.group_id);
+        if (message.status.mtype == ROUND_TRIP_MTYPE)
+        {
+            for (int i = 0; i < message.round_trip.count && round_trip_count < MAX_GROUPS * MAX_MESSAGES; i++)
+            {
+                round_trips[round_trip_count++] = message.round_trip.samples[i];
+            }
+            if (message.round_trip.last)
+            {
+                round_trip_groups++;
+                msg_buffer ack;
+                ack.mtype = ROUND_TRIP_ACK_MTYPE + message.round_trip.group_id;
+                ack.group_id = message.round_trip.group_id;
+                if (msgsnd(msgid, &ack, sizeof(ack) - sizeof(ack.mtype), 0) == -1)
+                {
+                    perror("Error sending round trip ack to group");
+                }
+            }
+            continue;
+        }
+        printf("All users terminated. Exiting group process %d. Status: inactive\n", message.status.group_id);
         active_groups--;
     }
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    int use_placement = 0;
+    int stats = 0;
+    int valid = argc >= 2;
+    for (int i = 2; i < argc && valid; i++)
+    {
+        if (strcmp(argv[i], "--placement") == 0)
+        {
+            use_placement = 1;
+        }
+        else if (strcmp(argv[i], "--stats") == 0)
+        {
+            stats = 1;
+        }
+        else
+        {
+            valid = 0;
+        }
+    }
+    if (!valid)
     {
-        fprintf(stderr, "Usage: %s <testcase_number>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <testcase_number> [--placement] [--stats]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
 
@@ -104,9 +216,20 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
-    GroupFormation(num_groups, groupFiles, app_key, mod_key, val_key, threshold, msgid, testcase);
+    Placement plan;
+    int placement = use_placement && BuildPlacement(&plan) == 0;
+    if (placement)
+    {
+        printf("Placement on: moderator on CPU %d, %d CPU(s) for groups\n", plan.moderator_cpu, plan.num_group_cpus);
+    }
+
+    GroupFormation(num_groups, groupFiles, app_key, mod_key, val_key, threshold, msgid, testcase, placement ? &plan : NULL, stats);
 
     printf("All groups terminated. Exiting app process.\n");
+    if (stats)
+    {
+        ReportRoundTrips(num_groups);
+    }
     msgctl(mod_key, IPC_RMID, NULL);
     return 0;
 }
@@ -9,11 +9,15 @@
 #include <sys/wait.h>
 #include <limits.h>
 #include <errno.h>
+#include <time.h>
 
 #define MAX_MSG_SIZE 256
 #define MAX_USERS 50
 #define MAX_TEXT_SIZE 256
 #define MAX_PATH_SIZE 256
+#define ROUND_TRIP_MTYPE 1000
+#define ROUND_TRIP_CHUNK 64
+#define ROUND_TRIP_ACK_MTYPE 2000
 
 // structure for message queue
 typedef struct
@@ -33,6 +37,17 @@ typedef struct
     char status[100];
 }app_buffer;
 
+// round trip samples sent to app.out with --stats, before the group's status message,
+// app.out answers the chunk marked last with ROUND_TRIP_ACK_MTYPE + group_id
+typedef struct
+{
+    long mtype;
+    int group_id;
+    int count;
+    int last;
+    long samples[ROUND_TRIP_CHUNK];
+} round_trip_buffer;
+
 // Structure for messages sent over pipes
 typedef struct
 {
@@ -77,12 +92,13 @@ void message_to_validation(int msgid, int mtype, int group_id, int user, int tim
     }
 }
 
-void message_to_moderator(int mod_msgid, int group_id, int user, const char *text)
+void message_to_moderator(int mod_msgid, int group_id, int user, int timestamp, const char *text)
 {
     Message mod_msg;
     mod_msg.mtype = 1;
     mod_msg.modifyingGroup = group_id;
     mod_msg.user = user;
+    mod_msg.timestamp = timestamp;
     strncpy(mod_msg.mtext, text, MAX_TEXT_SIZE);
 
     if (msgsnd(mod_msgid, &mod_msg, sizeof(mod_msg) - sizeof(mod_msg.mtype), 0) == -1)
@@ -155,6 +171,46 @@ void InitializeGroup(int group_id, const char *group_file, UserData users[], int
     fclose(file);
 }
 
+long elapsed_us(const struct timespec *start, const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000000L + (end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+// sends the moderator round trips to app.out, which pools them across groups.
+// Waits for app.out to confirm it has them all, validation.out removes the app
+// queue (and anything still queued) once every group has terminated
+void SendRoundTrips(int app_msgid, int group_id, const long samples[], int count)
+{
+    int sent = 0;
+    do
+    {
+        round_trip_buffer rtmsg;
+        rtmsg.mtype = ROUND_TRIP_MTYPE;
+        rtmsg.group_id = group_id;
+        rtmsg.count = count - sent < ROUND_TRIP_CHUNK ? count - sent : ROUND_TRIP_CHUNK;
+        rtmsg.last = sent + rtmsg.count == count;
+        memcpy(rtmsg.samples, samples + sent, rtmsg.count * sizeof(long));
+        if (msgsnd(app_msgid, &rtmsg, sizeof(rtmsg) - sizeof(rtmsg.mtype), 0) == -1)
+        {
+            if (errno != EINVAL && errno != EIDRM)
+            {
+                perror("Error sending round trips to app");
+            }
+            return;
+        }
+        sent += rtmsg.count;
+    } while (sent < count);
+
+    app_buffer ack;
+    if (msgrcv(app_msgid, &ack, sizeof(ack) - sizeof(ack.mtype), ROUND_TRIP_ACK_MTYPE + group_id, 0) == -1)
+    {
+        if (errno != EINVAL && errno != EIDRM)
+        {
+            perror("Error receiving round trip ack from app");
+        }
+    }
+}
+
 // for sorting compare timestamps
 int compare_timestamps(const void *a, const void *b)
 {
@@ -170,9 +226,11 @@ int compare_timestamps(const void *a, const void *b)
 //1. stores the user msgs in a buffer 
 //2. sorts the user msgs according to timestamps
 //3. sends the messages to validation and moderator
-void GroupProcess(int group_id, int num_users, UserData users[], int val_msgid, int mod_msgid,int app_msgid)
+void GroupProcess(int group_id, int num_users, UserData users[], int val_msgid, int mod_msgid,int app_msgid, int stats)
 {
     StoredMsgs user_messages[1000];
+    long round_trips[1000];
+    int round_trip_count = 0;
     int message_count = 0;
     int active_users = num_users;
 
@@ -284,11 +342,17 @@ void GroupProcess(int group_id, int num_users, UserData users[], int val_msgid,
         }
 
         message_to_validation(val_msgid, 30 + group_id, group_id, user_messages[i].user_id, user_messages[i].timestamp, user_messages[i].message);
-        message_to_moderator(mod_msgid, group_id, user_messages[i].user_id, user_messages[i].message);
+
+        struct timespec sent, replied;
+        clock_gettime(CLOCK_MONOTONIC, &sent);
+        message_to_moderator(mod_msgid, group_id, user_messages[i].user_id, user_messages[i].timestamp, user_messages[i].message);
 
         Message mod_msg;
         while (msgrcv(mod_msgid, &mod_msg, sizeof(mod_msg) - sizeof(mod_msg.mtype), 100 + group_id, 0) != -1)
         {
+            clock_gettime(CLOCK_MONOTONIC, &replied);
+            round_trips[round_trip_count++] = elapsed_us(&sent, &replied);
+
             int banned_user = mod_msg.user;
             int ban = mod_msg.is_ban;
 
@@ -327,6 +391,11 @@ void GroupProcess(int group_id, int num_users, UserData users[], int val_msgid,
             }
         }
     }
+    if (stats)
+    {
+        SendRoundTrips(app_msgid, group_id, round_trips, round_trip_count);
+    }
+
     int violation_removals = 0;
     for (int i = 0; i < num_users; i++)
     {
@@ -352,9 +421,9 @@ void GroupProcess(int group_id, int num_users, UserData users[], int val_msgid,
 
 int main(int argc, char *argv[])
 {
-    if (argc != 8)
+    if (argc != 8 && !(argc == 9 && strcmp(argv[8], "--stats") == 0))
     {
-        fprintf(stderr, "Usage: %s <group_file> <group_id> <app_key> <mod_key> <val_key> <threshold> <testcase>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <group_file> <group_id> <app_key> <mod_key> <val_key> <threshold> <testcase> [--stats]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
 
@@ -365,6 +434,7 @@ int main(int argc, char *argv[])
     int val_key = atoi(argv[5]);
     int threshold = atoi(argv[6]);
     int testcase = atoi(argv[7]);
+    int stats = argc == 9;
 
     int val_msgid = msgget(val_key, 0666);
     int mod_msgid = msgget(mod_key, 0666);
@@ -390,7 +460,7 @@ int main(int argc, char *argv[])
         }
     }
 
-    GroupProcess(group_id, num_users, users, val_msgid, mod_msgid,app_msgid);
+    GroupProcess(group_id, num_users, users, val_msgid, mod_msgid,app_msgid, stats);
     msgctl(mod_key, IPC_RMID, NULL);
 
     return 0;
@@ -1,13 +1,19 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
+#include <limits.h>
 #include <sys/ipc.h>
 #include <sys/msg.h>
+#include "placement.h"
 
 #define MAX_USERS 50
 #define MAX_MSG_SIZE 256
 #define MAX_WORDS 50
+#define WINDOW_BUCKETS 16
+#define WINDOW_SLOTS (WINDOW_BUCKETS + 1)
 
 typedef struct
 {
@@ -25,6 +31,26 @@ int violations[MAX_USERS][MAX_USERS] = {0};
 int removed_users[MAX_USERS][MAX_USERS] = {0};
 int NotBanned[MAX_USERS][MAX_USERS] = {0};
 
+// Per user ring of violation counts for --window mode. Each bucket covers
+// bucket_width timestamp units and remembers its latest violation, buckets
+// tail..head are still live. A bucket expires once that latest violation is
+// window_size units old, so nothing leaves the window early and a violation
+// counts for at most bucket_width - 1 units too long. With bucket_width at
+// least window_size / WINDOW_BUCKETS no more than WINDOW_SLOTS are ever live.
+typedef struct
+{
+    int counts[WINDOW_SLOTS];
+    int latest[WINDOW_SLOTS];
+    int head;
+    int tail;
+    int total;
+    int used;
+} ViolationWindow;
+
+ViolationWindow windows[MAX_USERS][MAX_USERS];
+int window_size = 0;
+int bucket_width = 0;
+
 // To load filtered words from the file given
 void LoadFilteredWords(int testcase)
 {
@@ -79,6 +105,54 @@ int count_violations(const char *message)
     return violation_count;
 }
 
+// adds count at timestamp and returns the violations in the last window_size
+// units, the oldest buckets are cleared as they expire so each bucket is
+// visited once on the way in and once on the way out
+int AddToWindow(ViolationWindow *window, int timestamp, int count)
+{
+    int bucket = timestamp / bucket_width;
+    if (!window->used)
+    {
+        window->head = bucket;
+        window->tail = bucket;
+        window->used = 1;
+    }
+
+    while (window->tail <= window->head && window->tail < bucket)
+    {
+        int slot = window->tail % WINDOW_SLOTS;
+        if (bucket - window->tail < WINDOW_SLOTS && window->counts[slot] > 0 &&
+            timestamp - window->latest[slot] < window_size)
+        {
+            break;
+        }
+        window->total -= window->counts[slot];
+        window->counts[slot] = 0;
+        window->tail++;
+    }
+    if (window->tail > window->head)
+    {
+        window->tail = bucket;
+    }
+    if (bucket > window->head)
+    {
+        window->head = bucket;
+    }
+
+    // groups send in timestamp order, anything older than the tail is already expired
+    if (bucket >= window->tail)
+    {
+        int slot = bucket % WINDOW_SLOTS;
+        window->counts[slot] += count;
+        if (window->counts[slot] == count || timestamp > window->latest[slot])
+        {
+            window->latest[slot] = timestamp;
+        }
+        window->total += count;
+    }
+    return window->total;
+}
+
 void ReadInputFile(int testcase, int *mod_key, int *threshold)
 {
     char filePath[256];
@@ -100,9 +174,33 @@ void ReadInputFile(int testcase, int *mod_key, int *threshold)
 // Marks the msgs received from the groups.c file as banned or not banned based on the no. of violations.
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    int placement = 0;
+    int valid = argc >= 2;
+    for (int i = 2; i < argc && valid; i++)
+    {
+        if (strcmp(argv[i], "--placement") == 0)
+        {
+            placement = 1;
+        }
+        else if (strcmp(argv[i], "--window") == 0 && i + 1 < argc)
+        {
+            char *end;
+            errno = 0;
+            long value = strtol(argv[++i], &end, 10);
+            if (errno != 0 || *end != '\0' || value <= 0 || value > INT_MAX)
+            {
+                valid = 0;
+            }
+            window_size = (int)value;
+        }
+        else
+        {
+            valid = 0;
+        }
+    }
+    if (!valid)
     {
-        fprintf(stderr, "Usage: %s <testcase_number>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <testcase_number> [--placement] [--window <timestamp_units>]\n", argv[0]);
         exit(EXIT_FAILURE);
     }
 
@@ -112,6 +210,13 @@ int main(int argc, char *argv[])
     ReadInputFile(testcase, &mod_key, &threshold);
     LoadFilteredWords(testcase);
 
+    // takes the core app.out keeps free of groups when run with the same flag
+    Placement plan;
+    if (placement && BuildPlacement(&plan) == 0)
+    {
+        PinToCpu(0, plan.moderator_cpu, "Moderator");
+    }
+
     int msgid = msgget(mod_key, 0666 | IPC_CREAT);
     if (msgid == -1)
     {
@@ -119,6 +224,13 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
+    // without --window the threshold applies to the lifetime total
+    if (window_size)
+    {
+        bucket_width = window_size / WINDOW_BUCKETS + (window_size % WINDOW_BUCKETS != 0);
+        printf("Counting violations within the last %d timestamp units\n", window_size);
+    }
+
     char command[100];
     snprintf(command, sizeof(command), "ipcrm -q %d", msgid);
 
@@ -136,26 +248,48 @@ int main(int argc, char *argv[])
         int group_id = msg.modifyingGroup;
         int violation_count = count_violations(msg.mtext);
 
-        violations[group_id][user_id] += violation_count;
-
-        printf("Message from group %d user %d: '%s' has %d violation(s)\n",
-               group_id, user_id, msg.mtext, violations[group_id][user_id]);
+        if (window_size)
+        {
+            violations[group_id][user_id] = AddToWindow(&windows[group_id][user_id], msg.timestamp, violation_count);
+        }
+        else
+        {
+            violations[group_id][user_id] += violation_count;
+        }
 
+        // decide and reply first so terminal output stays out of the group's round trip
+        int is_ban = -1;
         NotBanned[group_id][user_id] = 0;
         if (violations[group_id][user_id] >= threshold && !removed_users[group_id][user_id])
         {
-            printf("**User %d from group %d has been removed due to %d violations.**\n",
-                   user_id, group_id, violations[group_id][user_id]);
-
+            is_ban = 1;
             removed_users[group_id][user_id] = 1;
+        }
+        else if (violations[group_id][user_id] < threshold && !NotBanned[group_id][user_id])
+        {
+            is_ban = 0;
+        }
 
-            Message remove_msg;
+        int sent = 0;
+        Message remove_msg;
+        if (is_ban != -1)
+        {
             remove_msg.mtype = 100 + group_id;
             remove_msg.modifyingGroup = group_id;
             remove_msg.user = user_id;
-            remove_msg.is_ban = 1;
+            remove_msg.is_ban = is_ban;
+            sent = msgsnd(msgid, &remove_msg, sizeof(remove_msg) - sizeof(remove_msg.mtype), 0);
+        }
+
+        printf("Message from group %d user %d: '%s' has %d violation(s)\n",
+               group_id, user_id, msg.mtext, violations[group_id][user_id]);
 
-            if (msgsnd(msgid, &remove_msg, sizeof(remove_msg) - sizeof(remove_msg.mtype), 0) == -1)
+        if (is_ban == 1)
+        {
+            printf("**User %d from group %d has been removed due to %d violations.**\n",
+                   user_id, group_id, violations[group_id][user_id]);
+
+            if (sent == -1)
             {
                 perror("Error sending remove message to group");
             }
@@ -164,15 +298,9 @@ int main(int argc, char *argv[])
                 printf("Successfully sent remove message: %d of group %d\n", remove_msg.user, remove_msg.modifyingGroup);
             }
         }
-        else if (violations[group_id][user_id] < threshold && !NotBanned[group_id][user_id])
+        else if (is_ban == 0)
         {
-            NotBanned[group_id][user_id] = 1;
-            Message remove_msg;
-            remove_msg.mtype = 100 + group_id;
-            remove_msg.modifyingGroup = group_id;
-            remove_msg.user = user_id;
-            remove_msg.is_ban = 0;
-            if (msgsnd(msgid, &remove_msg, sizeof(remove_msg) - sizeof(remove_msg.mtype), 0) == -1)
+            if (sent == -1)
             {
                 perror("Error sending remove message to group");
             }
@@ -0,0 +1,233 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+// needs _GNU_SOURCE defined before the first system header of the including file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sched.h>
+#include <sys/types.h>
+
+#define MAX_CPUS 1024
+#define SYSFS_CPU "/sys/devices/system/cpu"
+
+// CPU topology read from sysfs, restricted to the CPUs this process may run on
+typedef struct
+{
+    int cpu;
+    int core;  // lowest cpu among the SMT siblings of this cpu
+    int llc;   // lowest cpu sharing the last level cache
+    int node;  // NUMA node, 0 when the kernel does not expose one
+} CpuInfo;
+
+// The moderator gets its own physical core, groups are spread over the rest
+// ordered by distance from the moderator: same LLC, then same node, then others
+typedef struct
+{
+    int moderator_cpu;
+    int group_cpus[MAX_CPUS];
+    int num_group_cpus;
+} Placement;
+
+// first cpu of a sysfs cpulist such as "0-3,8-11", -1 if the file is missing
+static inline int ReadFirstCpu(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return -1;
+    }
+    int cpu = -1;
+    if (fscanf(file, "%d", &cpu) != 1)
+    {
+        cpu = -1;
+    }
+    fclose(file);
+    return cpu;
+}
+
+static inline int ReadLLC(int cpu)
+{
+    char path[256];
+    int llc = cpu;
+    int llc_level = 0;
+    // the last level cache is the data or unified cache with the largest level
+    for (int index = 0;; index++)
+    {
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/level", cpu, index);
+        FILE *file = fopen(path, "r");
+        if (!file)
+        {
+            break;
+        }
+        int level = 0;
+        if (fscanf(file, "%d", &level) != 1)
+        {
+            level = 0;
+        }
+        fclose(file);
+
+        char type[32] = "";
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/type", cpu, index);
+        file = fopen(path, "r");
+        if (file)
+        {
+            if (fscanf(file, "%31s", type) != 1)
+            {
+                type[0] = '\0';
+            }
+            fclose(file);
+        }
+        if (strcmp(type, "Instruction") == 0 || level <= llc_level)
+            continue;
+
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/cache/index%d/shared_cpu_list", cpu, index);
+        int first = ReadFirstCpu(path);
+        if (first != -1)
+        {
+            llc = first;
+            llc_level = level;
+        }
+    }
+    return llc;
+}
+
+static inline int ReadNode(int cpu)
+{
+    char path[256];
+    snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (!dir)
+    {
+        return 0;
+    }
+    int node = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (strncmp(entry->d_name, "node", 4) == 0)
+        {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+static inline int ReadTopology(CpuInfo cpus[])
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+    {
+        perror("Error reading CPU affinity");
+        return 0;
+    }
+
+    int count = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && count < MAX_CPUS; cpu++)
+    {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+
+        char path[256];
+        snprintf(path, sizeof(path), SYSFS_CPU "/cpu%d/topology/thread_siblings_list", cpu);
+        int core = ReadFirstCpu(path);
+
+        cpus[count].cpu = cpu;
+        cpus[count].core = core == -1 ? cpu : core;
+        cpus[count].llc = ReadLLC(cpu);
+        cpus[count].node = ReadNode(cpu);
+        count++;
+    }
+    return count;
+}
+
+// rank of a group cpu: lower ranks are closer to the moderator, SMT siblings
+// of already ranked cores come last within each level
+static inline int PlacementRank(const CpuInfo *info, const CpuInfo *moderator)
+{
+    int rank;
+    if (info->llc == moderator->llc)
+        rank = 0;
+    else if (info->node == moderator->node)
+        rank = 2;
+    else
+        rank = 4;
+    if (info->core != info->cpu)
+        rank++;
+    return rank;
+}
+
+// app.out and moderator.out both call this, the plan only depends on sysfs
+// and the inherited affinity mask so both sides agree without any IPC
+static inline int BuildPlacement(Placement *plan)
+{
+    static CpuInfo cpus[MAX_CPUS];
+    int count = ReadTopology(cpus);
+    plan->num_group_cpus = 0;
+    plan->moderator_cpu = -1;
+    if (count == 0)
+    {
+        return -1;
+    }
+
+    const CpuInfo *moderator = &cpus[0];
+    plan->moderator_cpu = moderator->cpu;
+
+    for (int rank = 0; rank < 6; rank++)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            // keep the moderator's whole physical core to itself
+            if (cpus[i].core == moderator->core)
+                continue;
+            if (PlacementRank(&cpus[i], moderator) == rank)
+            {
+                plan->group_cpus[plan->num_group_cpus++] = cpus[i].cpu;
+            }
+        }
+    }
+
+    // single core machine, everyone shares the moderator's cpu
+    if (plan->num_group_cpus == 0)
+    {
+        plan->group_cpus[plan->num_group_cpus++] = moderator->cpu;
+    }
+    return 0;
+}
+
+static inline int GroupCpu(const Placement *plan, int index)
+{
+    return plan->group_cpus[index % plan->num_group_cpus];
+}
+
+// pins pid (0 for the caller) to a single cpu and prints the resulting mask
+static inline int PinToCpu(pid_t pid, int cpu, const char *who)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(pid, sizeof(set), &set) == -1)
+    {
+        perror("Error setting CPU affinity");
+        return -1;
+    }
+
+    CPU_ZERO(&set);
+    if (sched_getaffinity(pid, sizeof(set), &set) == 0)
+    {
+        printf("%s pinned to CPU %d (affinity:", who, cpu);
+        for (int i = 0; i < CPU_SETSIZE; i++)
+        {
+            if (CPU_ISSET(i, &set))
+                printf(" %d", i);
+        }
+        printf(")\n");
+    }
+    return 0;
+}
+
+#endif